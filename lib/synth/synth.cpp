@@ -0,0 +1,269 @@
+#include "synth.h"
+#include <Arduino.h>
+#include <cmath>
+#include "hal/ledc_ll.h"
+#include "soc/ledc_struct.h"
+
+// Output properties
+const int PWM_RESOLUTION = 8;          // 8 bit samples map directly onto the duty cycle
+const uint32_t PWM_FREQUENCY = 156250; // Carrier well above the audible range
+const uint32_t SAMPLE_PERIOD_US = 64;  // 15625 Hz sample rate
+const uint8_t SAMPLE_TIMER = 0;
+const uint16_t SAMPLE_TIMER_DIVIDER = 80; // 1 MHz timer clock
+
+// Envelope levels are 8.16 fixed point
+const uint32_t MAX_LEVEL = 255UL << 16;
+
+const uint32_t Synth::SAMPLE_RATE = 1000000 / SAMPLE_PERIOD_US;
+const uint32_t Synth::MAX_FREQUENCY = Synth::SAMPLE_RATE / 2;
+
+namespace
+{
+    struct Voice
+    {
+        bool active;
+        uint8_t waveform;
+        uint8_t volume;
+
+        // Synthesized notes
+        uint32_t phase;           // Position within the current cycle (0 to 2^32)
+        uint32_t phase_inc;       // Phase advance per sample, determines the frequency
+        int32_t phase_inc_step;   // Change of phase_inc per sample, for pitch slides
+        uint32_t samples_left;    // Samples until the note ends
+        uint32_t level;           // Current attack envelope level, rises to MAX_LEVEL
+        uint32_t attack_step;     // Attack envelope level increase per sample
+        uint32_t release_samples; // Length of the release ramp at the end of the note
+        uint32_t release_step;    // Release envelope level per sample left, so it falls from MAX_LEVEL to 0
+
+        // PCM samples
+        const uint8_t *samples;
+        size_t length;
+        size_t position;
+    };
+
+    Voice voices[Synth::NUM_VOICES];
+    portMUX_TYPE voices_mux = portMUX_INITIALIZER_UNLOCKED;
+    uint8_t sine_table[256];
+
+    hw_timer_t *sample_timer = nullptr;
+    int output_channel = 0;
+    // The LEDC speed mode and channel behind output_channel, the same split Arduino's ledc* functions use.
+    ledc_mode_t output_group = LEDC_LOW_SPEED_MODE;
+    ledc_channel_t output_group_channel = LEDC_CHANNEL_0;
+    uint32_t last_output = 0;
+    bool running = false;
+
+    uint32_t ms_to_samples(uint32_t ms)
+    {
+        return ms * Synth::SAMPLE_RATE / 1000;
+    }
+
+    // Frequencies above MAX_FREQUENCY would alias (and wrap the phase from SAMPLE_RATE up), so they're clamped.
+    uint32_t frequency_to_phase_inc(uint16_t frequency)
+    {
+        if (frequency > Synth::MAX_FREQUENCY)
+            frequency = Synth::MAX_FREQUENCY;
+        return (uint32_t)(((uint64_t)frequency << 32) / Synth::SAMPLE_RATE);
+    }
+
+    // PolyBLEP residual of a square wave edge for a sample that is `distance` (in phase units) away from it:
+    // (1 - distance / phase_inc)^2, scaled to half the square wave's amplitude, and 0 past one sample.
+    // Works in 32 bits (phase_inc >> 16 is at most 2^15 below Nyquist), as 64 bit division is too slow here.
+    uint32_t IRAM_ATTR poly_blep(uint32_t distance, uint32_t phase_inc)
+    {
+        uint32_t inc = phase_inc >> 16;
+        if (inc == 0 || distance >= phase_inc)
+            return 0;
+        uint32_t x = 32768 - ((distance >> 16) << 15) / inc; // 1 - distance / phase_inc, 0.15 fixed point
+        return ((x * x) >> 15) * 128 >> 15;
+    }
+
+    // A square wave with its edges smoothed by PolyBLEP. Point-sampling the ideal square wave aliases
+    // its harmonics above MAX_FREQUENCY back into the audible range.
+    uint32_t IRAM_ATTR square_sample(uint32_t phase, uint32_t phase_inc)
+    {
+        const uint32_t half = 0x80000000UL;
+        int32_t value = phase < half ? 255 : 0;
+        value -= poly_blep(phase, phase_inc); // Just after the rising edge
+        if (phase != 0)
+            value += poly_blep(0 - phase, phase_inc); // Just before the rising edge
+        value += poly_blep(phase - half, phase_inc); // Just after the falling edge
+        if (phase != half)
+            value -= poly_blep(half - phase, phase_inc); // Just before the falling edge
+        return value < 0 ? 0 : value > 255 ? 255 : value;
+    }
+
+    // An if chain rather than a switch, so that no jump table ends up in flash.
+    uint32_t IRAM_ATTR waveform_sample(uint8_t waveform, uint32_t phase, uint32_t phase_inc)
+    {
+        uint8_t index = phase >> 24;
+        if (waveform == Synth::TRIANGLE)
+            return index < 128 ? index * 2 : (255 - index) * 2;
+        if (waveform == Synth::SAWTOOTH)
+            return index;
+        if (waveform == Synth::SINE)
+            return sine_table[index];
+        return square_sample(phase, phase_inc); // Synth::SQUARE
+    }
+
+    // Writes a duty cycle straight to the LEDC registers. The LEDC driver (ledcWrite) lives in flash,
+    // takes a spinlock and logs, so it can't be used from the sample timer ISR. This relies on the
+    // duty fade parameters having been set up once by the driver in Synth::begin().
+    void IRAM_ATTR write_duty(uint32_t duty)
+    {
+        ledc_dev_t *hw = LEDC_LL_GET_HW();
+        ledc_ll_set_duty_int_part(hw, output_group, output_group_channel, duty);
+        ledc_ll_set_duty_start(hw, output_group, output_group_channel, true);
+        if (output_group == LEDC_LOW_SPEED_MODE)
+            ledc_ll_ls_channel_update(hw, output_group, output_group_channel);
+    }
+
+    uint32_t IRAM_ATTR render_voice(Voice &v)
+    {
+        if (v.samples != nullptr)
+        {
+            uint32_t value = v.samples[v.position] * v.volume / 255;
+            if (++v.position >= v.length)
+                v.active = false;
+            return value;
+        }
+
+        uint32_t value = waveform_sample(v.waveform, v.phase, v.phase_inc);
+        v.phase += v.phase_inc;
+        v.phase_inc += (uint32_t)v.phase_inc_step;
+
+        // The attack and release envelopes are independent ramps and the quieter one wins, so a release
+        // that starts before the attack has finished (e.g. a pluck, with release == duration) cuts into it.
+        if (v.level < MAX_LEVEL)
+            v.level = MAX_LEVEL - v.level > v.attack_step ? v.level + v.attack_step : MAX_LEVEL;
+        uint32_t level = v.level;
+        if (v.samples_left <= v.release_samples && v.samples_left * v.release_step < level)
+            level = v.samples_left * v.release_step;
+
+        if (--v.samples_left == 0)
+            v.active = false;
+        return value * (level >> 16) * v.volume / (255 * 255);
+    }
+
+    // Mixes one output sample of all voices. Runs at SAMPLE_RATE from the sample timer.
+    void IRAM_ATTR on_sample()
+    {
+        uint32_t mix = 0;
+        portENTER_CRITICAL_ISR(&voices_mux);
+        for (uint8_t i = 0; i < Synth::NUM_VOICES; i++)
+        {
+            if (voices[i].active)
+                mix += render_voice(voices[i]);
+        }
+        portEXIT_CRITICAL_ISR(&voices_mux);
+
+        if (mix > 255)
+            mix = 255;
+        if (mix != last_output)
+        {
+            write_duty(mix);
+            last_output = mix;
+        }
+    }
+
+    // Sets up a voice under the lock shared with the sample timer and makes sure the timer is running.
+    void start_voice(uint8_t voice, const Voice &v)
+    {
+        if (voice >= Synth::NUM_VOICES || sample_timer == nullptr)
+            return;
+
+        portENTER_CRITICAL(&voices_mux);
+        voices[voice] = v;
+        portEXIT_CRITICAL(&voices_mux);
+
+        if (!running)
+        {
+            timerAlarmEnable(sample_timer);
+            running = true;
+        }
+    }
+}
+
+void Synth::begin(int pin, int pwmChannel)
+{
+    for (int i = 0; i < 256; i++)
+        sine_table[i] = (uint8_t)lroundf(127.5f + 127.5f * sinf(2.0f * (float)M_PI * i / 256.0f));
+
+    output_channel = pwmChannel;
+    output_group = (ledc_mode_t)(pwmChannel / 8);
+    output_group_channel = (ledc_channel_t)(pwmChannel % 8);
+    ledcSetup(output_channel, PWM_FREQUENCY, PWM_RESOLUTION);
+    ledcAttachPin(pin, output_channel);
+    ledcWrite(output_channel, 0);
+
+    sample_timer = timerBegin(SAMPLE_TIMER, SAMPLE_TIMER_DIVIDER, true);
+    timerAttachInterrupt(sample_timer, &on_sample, false);
+    timerAlarmWrite(sample_timer, SAMPLE_PERIOD_US, true);
+}
+
+void Synth::note(uint8_t voice, Waveform waveform, uint8_t volume, uint16_t startFrequency, uint16_t endFrequency,
+                 uint16_t durationMs, uint16_t attackMs, uint16_t releaseMs)
+{
+    uint32_t samples = ms_to_samples(durationMs);
+    if (samples == 0 || startFrequency == 0)
+        return;
+
+    uint32_t start_inc = frequency_to_phase_inc(startFrequency);
+    uint32_t end_inc = frequency_to_phase_inc(endFrequency == 0 ? startFrequency : endFrequency);
+    uint32_t attack_samples = ms_to_samples(attackMs);
+
+    Voice v = {};
+    v.active = true;
+    v.waveform = waveform;
+    v.volume = volume;
+    v.phase_inc = start_inc;
+    v.phase_inc_step = (int32_t)(((int64_t)end_inc - (int64_t)start_inc) / (int64_t)samples);
+    v.samples_left = samples;
+    v.attack_step = attack_samples == 0 ? MAX_LEVEL : MAX_LEVEL / attack_samples;
+    v.release_samples = min(ms_to_samples(releaseMs), samples);
+    v.release_step = v.release_samples == 0 ? 0 : MAX_LEVEL / v.release_samples;
+    start_voice(voice, v);
+}
+
+void Synth::pcm(uint8_t voice, const uint8_t *samples, size_t length, uint8_t volume)
+{
+    if (samples == nullptr || length == 0)
+        return;
+
+    Voice v = {};
+    v.active = true;
+    v.volume = volume;
+    v.samples = samples;
+    v.length = length;
+    start_voice(voice, v);
+}
+
+bool Synth::busy()
+{
+    bool busy = false;
+    portENTER_CRITICAL(&voices_mux);
+    for (uint8_t i = 0; i < NUM_VOICES; i++)
+        busy |= voices[i].active;
+    portEXIT_CRITICAL(&voices_mux);
+    return busy;
+}
+
+void Synth::stop()
+{
+    if (sample_timer == nullptr)
+        return;
+
+    if (running)
+    {
+        timerAlarmDisable(sample_timer);
+        running = false;
+    }
+
+    portENTER_CRITICAL(&voices_mux);
+    for (uint8_t i = 0; i < NUM_VOICES; i++)
+        voices[i].active = false;
+    portEXIT_CRITICAL(&voices_mux);
+
+    ledcWrite(output_channel, 0);
+    last_output = 0;
+}
@@ -0,0 +1,80 @@
+#ifndef SYNTH_H
+#define SYNTH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Synth
+{
+public:
+    /**
+     * @brief Waveforms a voice can synthesize.
+     */
+    enum Waveform : uint8_t
+    {
+        SQUARE = 0,
+        TRIANGLE = 1,
+        SAWTOOTH = 2,
+        SINE = 3,
+    };
+
+    /**
+     * @brief Number of voices mixed together.
+     */
+    static constexpr uint8_t NUM_VOICES = 2;
+
+    /**
+     * @brief Output sample rate in Hz, which is also the rate PCM samples are played at.
+     */
+    static const uint32_t SAMPLE_RATE;
+
+    /**
+     * @brief Highest frequency a note can have (the Nyquist frequency, SAMPLE_RATE / 2); higher ones are clamped to it.
+     */
+    static const uint32_t MAX_FREQUENCY;
+
+    /**
+     * @brief Sets up the high-frequency PWM output and the sample timer. Must be called once before anything else.
+     *
+     * @param pin The pin the buzzer is connected to.
+     * @param pwmChannel The LEDC channel used to drive the pin.
+     */
+    static void begin(int pin, int pwmChannel);
+
+    /**
+     * @brief Starts a synthesized note on a voice, replacing whatever the voice was playing. Returns immediately.
+     *
+     * @param voice The voice to play the note on (0 to NUM_VOICES - 1).
+     * @param waveform The waveform of the note.
+     * @param volume The peak amplitude of the note (0 to 255).
+     * @param startFrequency The frequency at the start of the note in Hz, at most MAX_FREQUENCY.
+     * @param endFrequency The frequency at the end of the note in Hz, at most MAX_FREQUENCY; the pitch slides linearly towards it.
+     * @param durationMs The total length of the note in milliseconds, including attack and release.
+     * @param attackMs The time to ramp up from silence to full volume in milliseconds.
+     * @param releaseMs The time to ramp down to silence at the end of the note in milliseconds.
+     */
+    static void note(uint8_t voice, Waveform waveform, uint8_t volume, uint16_t startFrequency, uint16_t endFrequency,
+                     uint16_t durationMs, uint16_t attackMs, uint16_t releaseMs);
+
+    /**
+     * @brief Starts streaming 8-bit unsigned PCM samples at SAMPLE_RATE on a voice. Returns immediately.
+     *
+     * @param voice The voice to play the samples on (0 to NUM_VOICES - 1).
+     * @param samples The samples; must stay valid until playback has finished or the voice is replaced.
+     * @param length The number of samples.
+     * @param volume The amplitude the samples are scaled by (0 to 255).
+     */
+    static void pcm(uint8_t voice, const uint8_t *samples, size_t length, uint8_t volume);
+
+    /**
+     * @brief Returns whether any voice is still playing.
+     */
+    static bool busy();
+
+    /**
+     * @brief Silences all voices and stops the sample timer.
+     */
+    static void stop();
+};
+
+#endif // SYNTH_H
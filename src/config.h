@@ -7,6 +7,14 @@
 // --- Web Server Configuration ---
 #define WEB_SERVER_PORT 5001
 
+// --- UDP Broadcast Configuration ---
+#define UDP_ENABLED 0 // Set to 1 to enable the UDP listener
+#define UDP_PORT 5002
+#define UDP_MULTICAST_ADDRESS IPAddress(239, 255, 77, 1)
+#define DEVICE_GROUP_ID 1 // Packets for group 0 are accepted by every device
+#define UDP_MAX_START_DELAY_MS 10000 // Start timestamps further in the future are ignored
+#define NTP_SERVER "pool.ntp.org" // Used to synchronize start timestamps between devices
+
 // --- Hardware Pins (ESP32-C3) ---
 // I2C for SSD1306 Display
 #define OLED_SDA_PIN 8
@@ -23,7 +31,9 @@
 #define SCREEN_WIDTH 128
 #define SCREEN_HEIGHT 64
 #define FRAME_BUFFER_SIZE (SCREEN_WIDTH * SCREEN_HEIGHT / 8)
-#define FRAME_DELAY_MS 100 // Delay between animation frames (10 FPS)
+#define FRAME_DELAY_MS 100 // Delay between animation keyframes sent by the server (10 FPS)
+#define FRAME_MIN_DELAY_MS 20 // Shortest delay between rendered frames (50 FPS)
+#define FRAME_CPU_BUDGET_PERCENT 50 // Share of the frame period that rendering and flushing may take
 #define MAX_ANIMATION_FRAMES 20
 
 // --- Touch Sensor Configuration ---
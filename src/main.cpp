@@ -1,30 +1,110 @@
 #include <Arduino.h>
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
+#include <AsyncUDP.h>
 #include <ESPAsyncWebServer.h>
 #include <HTTPClient.h>
 #include <WiFi.h>
 #include <Wire.h>
 #include "config.h"
 #include <ctype.h>
+#include <sys/time.h>
 #include "eyes.h"
+#include "synth.h"
 
 constexpr uint32_t ANIMATION_TASK_STACK_SIZE = 4096;
 constexpr uint32_t SOUND_TASK_STACK_SIZE = 2048;
 constexpr UBaseType_t ANIMATION_TASK_PRIORITY = 1;
 constexpr UBaseType_t SOUND_TASK_PRIORITY = 1;
 constexpr size_t SOUND_DATA_BUFFER_SIZE = 512;
+constexpr size_t SYNTH_DATA_BUFFER_SIZE = 8192;         // Room for about half a second of PCM samples
 constexpr int SOUND_PWM_CHANNEL = 0;
-constexpr int SOUND_RESOLUTION = 8;                     // 8 bit resolution
-constexpr int SOUND_ON = (1 << (SOUND_RESOLUTION - 1)); // 50% duty cycle
-constexpr int SOUND_OFF = 0;                            // 0% duty cycle
+constexpr size_t ANIMATION_NUM_PARAMS_PER_FRAME = 5;    // pupil_y, pupil_x, eyebrows_low, pupil_size, eyebrow_angle
+constexpr size_t ANIMATION_FRAME_PARAMS_SIZE = ANIMATION_NUM_PARAMS_PER_FRAME * sizeof(float);
+constexpr size_t ANIMATION_DATA_BUFFER_SIZE = MAX_ANIMATION_FRAMES * FRAME_BUFFER_SIZE;
+constexpr uint8_t SOUND_VOLUME = 255;                   // Volume of the square wave tones in the /play format
+constexpr uint8_t SYNTH_EVENT_NOTE = 0x01;
+constexpr uint8_t SYNTH_EVENT_WAIT = 0x02;
+constexpr uint8_t SYNTH_EVENT_PCM = 0x03;
+constexpr uint8_t UDP_PROTOCOL_VERSION = 1;
+constexpr size_t UDP_FRAGMENT_SIZE = 1024;              // Payload bytes in every fragment except the last one
+constexpr uint16_t UDP_MAX_FRAGMENTS = 32;              // Limited by the width of UdpReassembly::receivedMask
+constexpr uint8_t UDP_PACKET_TYPE_DRAW = 1;
+constexpr uint8_t UDP_PACKET_TYPE_PLAY = 2;
+constexpr uint8_t UDP_PACKET_TYPE_SYNTH = 3;
+
+// Error response texts are constant rather than built per request.
+static const char BAD_REQUEST_MISSING_PARAM[] = "Bad Request: parameter missing.";
+static const char BAD_REQUEST_INVALID_HEX[] = "Bad Request: invalid hex data.";
+
+/**
+ * @brief A decoded request payload handed over to a task.
+ *        Payloads live in static storage and are only rewritten after the task reading them has been stopped,
+ *        so tasks never own (or free) their parameter.
+ */
+struct Payload
+{
+    uint8_t *data;
+    size_t capacity;
+    size_t length;
+    uint64_t startTimeMs; // Unix time in milliseconds at which to start playback, 0 to start right away
+};
+
+/**
+ * @brief Header of a UDP packet carrying (a fragment of) a /draw or /play payload. All fields are little-endian.
+ *        The header is followed by fragmentLength bytes of raw (not hex-encoded) payload, which is placed at
+ *        offset fragmentIndex * UDP_FRAGMENT_SIZE. Retransmitting any packet is harmless: fragments of a clip
+ *        that is already assembled, or of a clip older than the latest one, are ignored.
+ */
+struct __attribute__((packed)) UdpPacketHeader
+{
+    char magic[2];           // 'M', 'O'
+    uint8_t version;         // UDP_PROTOCOL_VERSION
+    uint8_t type;            // UDP_PACKET_TYPE_DRAW, UDP_PACKET_TYPE_PLAY or UDP_PACKET_TYPE_SYNTH
+    uint16_t group;          // Target device group, 0 for all devices
+    uint16_t fragmentIndex;  // Index of this fragment within the clip
+    uint16_t fragmentCount;  // Number of fragments in the clip
+    uint16_t fragmentLength; // Number of payload bytes following the header
+    uint32_t sequence;       // Identifies the clip; increases with every new clip of a given type
+    uint64_t startTimeMs;    // Unix time in milliseconds at which to start playback, 0 to start right away
+};
+
+/**
+ * @brief Reassembly state of the latest clip received over UDP for one payload type.
+ */
+struct UdpReassembly
+{
+    bool active;           // Whether any clip has been seen yet
+    bool started;          // Whether the clip is done: received and started, or overwritten over HTTP
+    uint32_t sequence;     // Sequence number of the clip
+    uint32_t receivedMask; // Bit i is set once fragment i has been received
+};
+
+struct PlaybackSlot;
+typedef void (*PlayFunction)(PlaybackSlot *slot);
+
+/**
+ * @brief A long-lived task that plays one payload at a time.
+ *        The task is created once at startup and woken up for every clip, so handling a request never creates
+ *        or deletes a task (and never allocates or frees its stack).
+ */
+struct PlaybackSlot
+{
+    const char *name;
+    TaskHandle_t task;
+    SemaphoreHandle_t start; // Given to make the task call play
+    SemaphoreHandle_t idle;  // Held by the task while it's playing
+    PlayFunction play;       // What the task plays next
+    Payload *payload;        // The payload play reads
+    volatile bool abort;     // Set to make play return early
+};
 
 AsyncWebServer server(WEB_SERVER_PORT);
 Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET_PIN);
 HTTPClient http;
 
-TaskHandle_t animationTaskHandle = nullptr;
-TaskHandle_t soundTaskHandle = nullptr;
+static PlaybackSlot animationSlot = {"Animation Task"};
+static PlaybackSlot soundSlot = {"Sound Task"};
 TaskHandle_t wakingUpAnimationTaskHandle = nullptr;
 
 volatile bool touchDetected = false;
@@ -32,25 +112,67 @@ volatile bool touchRequestInProgress = false;
 
 unsigned long lastTouchTime = 0;
 
+// Frame rate governor state, kept across animations so that the measured cost carries over.
+volatile uint32_t frameCostUs = 0;
+volatile uint32_t framePeriodMs = FRAME_DELAY_MS;
+
+alignas(float) static uint8_t animationData[ANIMATION_DATA_BUFFER_SIZE];
+static uint8_t soundData[SOUND_DATA_BUFFER_SIZE];
+static Payload animationPayload = {animationData, sizeof(animationData), 0, 0};
+static uint8_t synthData[SYNTH_DATA_BUFFER_SIZE];
+static Payload soundPayload = {soundData, sizeof(soundData), 0, 0};
+static Payload synthPayload = {synthData, sizeof(synthData), 0, 0};
+static UdpReassembly animationReassembly = {};
+static UdpReassembly soundReassembly = {};
+static UdpReassembly synthReassembly = {};
+
+// HTTP requests (async_tcp task) and UDP packets (AsyncUDP task) both overwrite payloads and
+// stop/start the playback slots reading them; this mutex serializes those handovers.
+static SemaphoreHandle_t payloadMutex = nullptr;
+
+#if UDP_ENABLED
+AsyncUDP udp;
+#endif
+
+/**
+ * @brief Sleeps in a playback slot's task, waking up early if its playback gets aborted.
+ * @param slot The slot whose task is sleeping.
+ * @param ms The time to sleep in milliseconds.
+ * @return False if playback was aborted and should stop.
+ */
+bool sleepOrAbort(PlaybackSlot *slot, uint32_t ms)
+{
+    if (slot->abort)
+        return false;
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ms));
+    return !slot->abort;
+}
+
 /**
- * @brief Plays a tone on a specified pin.
- * @param pin The pin to play the tone on.
- * @param frequency The frequency of the tone in Hz.
+ * @brief Plays a square wave tone on the first synth voice and waits for it to finish.
+ * @param slot The slot playing the tone.
+ * @param frequency The frequency of the tone in Hz (clamped to Synth::MAX_FREQUENCY), or 0 for silence.
  * @param duration The duration of the tone in milliseconds.
+ * @return False if playback was aborted.
+ */
+bool playTone(PlaybackSlot *slot, int frequency, int duration)
+{
+    Synth::note(0, Synth::SQUARE, SOUND_VOLUME, frequency, frequency, duration, 0, 0);
+    return sleepOrAbort(slot, duration);
+}
+
+/**
+ * @brief Waits for all synth voices to finish playing, then silences the buzzer.
+ * @param slot The slot playing the sound.
  */
-void playTone(int pin, int frequency, int duration)
+void finishSound(PlaybackSlot *slot)
 {
-    if (frequency == 0)
+    while (Synth::busy())
     {
-        vTaskDelay(pdMS_TO_TICKS(duration));
-        return;
+        if (!sleepOrAbort(slot, 10))
+            return; // Whoever aborted playback silences the synth
     }
-    ledcSetup(SOUND_PWM_CHANNEL, frequency, SOUND_RESOLUTION); // Set up PWM channel
-    ledcAttachPin(pin, SOUND_PWM_CHANNEL);                     // Attach channel to pin
-    ledcWrite(SOUND_PWM_CHANNEL, SOUND_ON);
-    vTaskDelay(pdMS_TO_TICKS(duration));
-    ledcWrite(SOUND_PWM_CHANNEL, SOUND_OFF);
-    ledcDetachPin(pin);
+    Synth::stop();
 }
 
 /**
@@ -87,39 +209,86 @@ void connectToWiFi()
     Serial.println(ipAddress);
 }
 
+/**
+ * @brief Blocks until the payload's start time, so that devices receiving the same clip play it in sync.
+ *        Starts right away if there's no start time, the clock isn't synchronized yet, or the start time has
+ *        passed or is more than UDP_MAX_START_DELAY_MS away.
+ * @param slot The slot about to play its payload.
+ * @return False if playback was aborted while waiting.
+ */
+bool waitForStartTime(PlaybackSlot *slot)
+{
+    const Payload *payload = slot->payload;
+    if (payload->startTimeMs == 0)
+        return true;
+
+    struct timeval now;
+    gettimeofday(&now, nullptr);
+    if (now.tv_sec < 1600000000)
+        return true; // Clock not synchronized by SNTP yet
+
+    int64_t nowMs = (int64_t)now.tv_sec * 1000 + now.tv_usec / 1000;
+    int64_t delayMs = (int64_t)payload->startTimeMs - nowMs;
+    if (delayMs > 0 && delayMs <= UDP_MAX_START_DELAY_MS)
+        return sleepOrAbort(slot, delayMs);
+    return true;
+}
+
+/**
+ * @brief Converts a lowercase hex digit to its value.
+ * @param c The hex character.
+ * @return The value of the digit (0 to 15), or -1 if c isn't a lowercase hex digit.
+ */
+static int hexNibble(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return 10 + (c - 'a');
+    return -1;
+}
+
+/**
+ * @brief Checks whether hexToBytes would succeed, without writing anything.
+ * @param hex The input hex characters (lowercase), not necessarily null-terminated.
+ * @param len The number of hex characters.
+ * @param outMax The maximum size of the output array.
+ * @return True if the input is a non-empty, even number of lowercase hex digits that fits in outMax bytes.
+ */
+static bool isValidHex(const char *hex, size_t len, size_t outMax)
+{
+    if (len == 0 || len % 2 != 0 || len / 2 > outMax)
+        return false;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        if (hexNibble(hex[i]) < 0)
+            return false;
+    }
+    return true;
+}
+
 /**
  * @brief Converts a hex string to a byte array.
- * @param hex The input hex string (lowercase).
+ * @param hex The input hex characters (lowercase), not necessarily null-terminated.
+ * @param len The number of hex characters.
  * @param out The output byte array.
  * @param outMax The maximum size of the output array.
  * @return The number of bytes written, or 0 on error.
  */
-static size_t hexToBytes(const String &hex, uint8_t *out, size_t outMax)
+static size_t hexToBytes(const char *hex, size_t len, uint8_t *out, size_t outMax)
 {
-    size_t len = hex.length();
     if (len % 2 != 0)
         return 0; // Not an even number of hex digits
+    if (len / 2 > outMax)
+        return 0; // Does not fit in the output buffer
 
     size_t outIndex = 0;
     for (size_t i = 0; i < len; i += 2)
     {
-        char hi_c = hex[i];
-        char lo_c = hex[i + 1];
-
-        int hi, lo;
-
-        if (hi_c >= '0' && hi_c <= '9')
-            hi = hi_c - '0';
-        else if (hi_c >= 'a' && hi_c <= 'f')
-            hi = 10 + (hi_c - 'a');
-        else
-            return 0; // Invalid character
-
-        if (lo_c >= '0' && lo_c <= '9')
-            lo = lo_c - '0';
-        else if (lo_c >= 'a' && lo_c <= 'f')
-            lo = 10 + (lo_c - 'a');
-        else
+        int hi = hexNibble(hex[i]);
+        int lo = hexNibble(hex[i + 1]);
+        if (hi < 0 || lo < 0)
             return 0; // Invalid character
 
         out[outIndex++] = (hi << 4) | lo;
@@ -128,31 +297,32 @@ static size_t hexToBytes(const String &hex, uint8_t *out, size_t outMax)
 }
 
 /**
- * @brief Task to generate and display eye animations on the OLED screen.
- * @param pvParameters A pointer to a String object containing a single hex-encoded blob of eye parameters.
- *                     Each frame is represented by 5 floats: pupil_y, pupil_x, eyebrows_low, pupil_size, eyebrow_angle.
- *                     This task is responsible for deleting the String object.
+ * @brief Updates the frame rate governor with the measured cost of one frame.
+ *        Picks the shortest frame period for which rendering and flushing stay within FRAME_CPU_BUDGET_PERCENT,
+ *        bounded by FRAME_MIN_DELAY_MS and FRAME_DELAY_MS.
+ * @param costUs The time it took to render the frame and flush it to the display, in microseconds.
  */
-void animationTask(void *pvParameters)
+void updateFrameGovernor(uint32_t costUs)
 {
-    String *paramsHex = static_cast<String *>(pvParameters);
+    // Exponential moving average (1/8 weight) smooths out occasional slow I2C transfers.
+    frameCostUs = frameCostUs == 0 ? costUs : (frameCostUs * 7 + costUs) / 8;
 
-    // Each frame is defined by 5 floats.
-    constexpr size_t NUM_PARAMS_PER_FRAME = 5;
-    constexpr size_t FRAME_PARAMS_SIZE = NUM_PARAMS_PER_FRAME * sizeof(float);
-
-    // We can't know the number of frames in advance, so we'll allocate a reasonably large buffer for the decoded data.
-    // Let's use the same size as before, which was MAX_ANIMATION_FRAMES * FRAME_BUFFER_SIZE.
-    // This should be more than enough for the parameters.
-    static uint8_t decodedData[MAX_ANIMATION_FRAMES * FRAME_BUFFER_SIZE];
+    uint32_t periodMs = (frameCostUs * 100 / FRAME_CPU_BUDGET_PERCENT + 999) / 1000;
+    framePeriodMs = constrain(periodMs, (uint32_t)FRAME_MIN_DELAY_MS, (uint32_t)FRAME_DELAY_MS);
+}
 
-    size_t decodedLen = hexToBytes(*paramsHex, decodedData, sizeof(decodedData));
-    Serial.printf("Decoding %u chars of hex data for eye animation...\r\n", paramsHex->length());
-    if (decodedLen == 0)
-    {
-        Serial.printf("Decoding hex of eye animation failed.\r\n");
-        goto cleanup;
-    }
+/**
+ * @brief Generates and displays eye animations on the OLED screen.
+ * @param slot The animation slot; its Payload holds the decoded eye parameters.
+ *                     Each keyframe is represented by 5 floats: pupil_y, pupil_x, eyebrows_low, pupil_size, eyebrow_angle.
+ *                     Keyframes are FRAME_DELAY_MS apart; frames in between are interpolated at the rate picked by
+ *                     the frame rate governor.
+ */
+void playAnimation(PlaybackSlot *slot)
+{
+    const Payload *payload = slot->payload;
+    if (!waitForStartTime(slot))
+        return;
 
     // Buffer for one frame of the eye image
     static unsigned char frameBuffer[FRAME_BUFFER_SIZE];
@@ -162,86 +332,161 @@ void animationTask(void *pvParameters)
     display.clearDisplay();
     display.drawBitmap(0, 0, frameBuffer, SCREEN_WIDTH, SCREEN_HEIGHT, SSD1306_WHITE);
     display.display();
-    vTaskDelay(pdMS_TO_TICKS(100));
+    if (!sleepOrAbort(slot, 100))
+        return;
 
     // Draw half-open eyes
     Eyes::draw_half_open(frameBuffer);
     display.clearDisplay();
     display.drawBitmap(0, 0, frameBuffer, SCREEN_WIDTH, SCREEN_HEIGHT, SSD1306_WHITE);
     display.display();
-    vTaskDelay(pdMS_TO_TICKS(100));
+    if (!sleepOrAbort(slot, 100))
+        return;
+
+    // Sample the keyframes at the governed frame rate
+    const float *keyframes = reinterpret_cast<const float *>(payload->data);
+    const size_t numKeyframes = payload->length / ANIMATION_FRAME_PARAMS_SIZE;
+    const uint32_t durationMs = numKeyframes * FRAME_DELAY_MS;
+    const TickType_t startTick = xTaskGetTickCount();
+    float params[ANIMATION_NUM_PARAMS_PER_FRAME];
+    float lastParams[ANIMATION_NUM_PARAMS_PER_FRAME];
+    size_t renderedFrames = 0;
 
-    // Process each set of frame parameters from the decoded data
-    for (size_t i = 0; i + FRAME_PARAMS_SIZE <= decodedLen; i += FRAME_PARAMS_SIZE)
+    while (true)
     {
-        float *params = reinterpret_cast<float *>(decodedData + i);
-        float pupil_y = params[0];
-        float pupil_x = params[1];
-        float eyebrows_low = params[2];
-        float pupil_size = params[3];
-        float eyebrow_angle = params[4];
+        TickType_t frameTick = xTaskGetTickCount();
+        uint32_t elapsedMs = (frameTick - startTick) * portTICK_PERIOD_MS;
+        if (elapsedMs >= durationMs)
+            break;
 
-        // Generate the eye image for the current frame
-        Eyes::draw_open(pupil_y, pupil_x, eyebrows_low, pupil_size, eyebrow_angle, frameBuffer);
+        // Interpolate between the current keyframe and the next one (the last keyframe is held)
+        size_t k = elapsedMs / FRAME_DELAY_MS;
+        float t = (float)(elapsedMs % FRAME_DELAY_MS) / FRAME_DELAY_MS;
+        const float *from = keyframes + k * ANIMATION_NUM_PARAMS_PER_FRAME;
+        const float *to = (k + 1 < numKeyframes) ? from + ANIMATION_NUM_PARAMS_PER_FRAME : from;
+        for (size_t p = 0; p < ANIMATION_NUM_PARAMS_PER_FRAME; p++)
+            params[p] = from[p] + (to[p] - from[p]) * t;
+
+        if (renderedFrames > 0 && memcmp(params, lastParams, sizeof(params)) == 0)
+        {
+            // Nothing is moving: sleep until the segment leading to the next differing keyframe starts.
+            size_t next = k + 1;
+            while (next < numKeyframes && memcmp(keyframes + next * ANIMATION_NUM_PARAMS_PER_FRAME, from, ANIMATION_FRAME_PARAMS_SIZE) == 0)
+                next++;
+            uint32_t resumeMs = next < numKeyframes ? (next - 1) * FRAME_DELAY_MS : durationMs;
+            if (!sleepOrAbort(slot, resumeMs > elapsedMs ? resumeMs - elapsedMs : framePeriodMs))
+                return;
+            continue;
+        }
 
-        // Display the generated frame
+        // Generate the eye image for the current frame and display it
+        uint32_t renderStartUs = micros();
+        Eyes::draw_open(params[0], params[1], params[2], params[3], params[4], frameBuffer);
         display.clearDisplay();
         display.drawBitmap(0, 0, frameBuffer, SCREEN_WIDTH, SCREEN_HEIGHT, SSD1306_WHITE);
         display.display();
-        vTaskDelay(pdMS_TO_TICKS(FRAME_DELAY_MS));
+        updateFrameGovernor(micros() - renderStartUs);
+
+        memcpy(lastParams, params, sizeof(params));
+        renderedFrames++;
+        uint32_t spentMs = (xTaskGetTickCount() - frameTick) * portTICK_PERIOD_MS;
+        if (!sleepOrAbort(slot, framePeriodMs > spentMs ? framePeriodMs - spentMs : 0))
+            return;
     }
+    Serial.printf("Rendered %u frames from %u keyframes, frame cost: %u us, frame period: %u ms (budget %u%%).\r\n",
+                  renderedFrames, numKeyframes, frameCostUs, framePeriodMs, FRAME_CPU_BUDGET_PERCENT);
 
     // Draw half-open eyes at the end
     Eyes::draw_half_open(frameBuffer);
     display.clearDisplay();
     display.drawBitmap(0, 0, frameBuffer, SCREEN_WIDTH, SCREEN_HEIGHT, SSD1306_WHITE);
     display.display();
-    vTaskDelay(pdMS_TO_TICKS(100));
+    if (!sleepOrAbort(slot, 100))
+        return;
 
     // Draw closed eyes at the end
     Eyes::draw_closed(frameBuffer);
     display.clearDisplay();
     display.drawBitmap(0, 0, frameBuffer, SCREEN_WIDTH, SCREEN_HEIGHT, SSD1306_WHITE);
     display.display();
-    vTaskDelay(pdMS_TO_TICKS(200));
-
-cleanup:
-    delete paramsHex;
-    animationTaskHandle = nullptr;
-    vTaskDelete(nullptr); // Task deletes itself
+    sleepOrAbort(slot, 200);
 }
 
 /**
- * @brief Task to play a sound on the buzzer.
- * @param pvParameters A pointer to a String object containing hex encoded sound data.
- *                     Sound data format (hex bytes): [freq_high, freq_low, dur_high, dur_low, ...]
- *                     This task is responsible for deleting the String object.
+ * @brief Plays a sound on the buzzer.
+ * @param slot The sound slot; its Payload holds the decoded sound data.
+ *                     Sound data format (bytes): [freq_high, freq_low, dur_high, dur_low, ...]
  */
-void soundTask(void *pvParameters)
+void playSound(PlaybackSlot *slot)
 {
-    String *soundHex = static_cast<String *>(pvParameters);
+    const Payload *payload = slot->payload;
+    if (!waitForStartTime(slot))
+        return;
 
-    uint8_t soundData[SOUND_DATA_BUFFER_SIZE];
-    size_t decodedLen = hexToBytes(*soundHex, soundData, sizeof(soundData));
-    Serial.printf("Decoding %u chars of hex data for sound...\r\n", soundHex->length());
-    if (decodedLen == 0)
+    // Sound data consists of pairs of (uint16_t frequency, uint16_t duration)
+    for (size_t i = 0; i + 3 < payload->length; i += 4)
     {
-        Serial.printf("Decoding hex of sound data failed.\r\n");
-        goto cleanup;
+        uint16_t freq = (payload->data[i] << 8) | payload->data[i + 1];
+        uint16_t duration = (payload->data[i + 2] << 8) | payload->data[i + 3];
+        if (!playTone(slot, freq, duration))
+            return;
     }
+    finishSound(slot);
+}
 
-    // Sound data consists of pairs of (uint16_t frequency, uint16_t duration)
-    for (size_t i = 0; i + 3 < decodedLen; i += 4)
+/**
+ * @brief Plays a sequence of synth events on the buzzer.
+ * @param slot The sound slot; its Payload holds the decoded synth events.
+ *                     Each event starts with its type byte, multi-byte values are big-endian:
+ *                     - Note (14 bytes): [0x01, voice, waveform, volume, start_freq(2), end_freq(2), duration(2), attack(2), release(2)]
+ *                       Starts a note without waiting for it; frequencies in Hz (up to Synth::MAX_FREQUENCY),
+ *                       times in milliseconds.
+ *                     - Wait (3 bytes): [0x02, duration(2)]
+ *                     - PCM (5 + length bytes): [0x03, voice, volume, length(2), samples...]
+ *                       Starts streaming 8-bit unsigned samples at Synth::SAMPLE_RATE without waiting for them.
+ *                     Returns once all voices have finished.
+ */
+void playSynth(PlaybackSlot *slot)
+{
+    const Payload *payload = slot->payload;
+    const uint8_t *data = payload->data;
+    if (!waitForStartTime(slot))
+        return;
+
+    size_t i = 0;
+    while (i < payload->length)
     {
-        uint16_t freq = (soundData[i] << 8) | soundData[i + 1];
-        uint16_t duration = (soundData[i + 2] << 8) | soundData[i + 3];
-        playTone(BUZZER_PIN, freq, duration);
+        uint8_t event = data[i];
+        if (event == SYNTH_EVENT_NOTE && i + 14 <= payload->length)
+        {
+            uint16_t startFreq = (data[i + 4] << 8) | data[i + 5];
+            uint16_t endFreq = (data[i + 6] << 8) | data[i + 7];
+            uint16_t duration = (data[i + 8] << 8) | data[i + 9];
+            uint16_t attack = (data[i + 10] << 8) | data[i + 11];
+            uint16_t release = (data[i + 12] << 8) | data[i + 13];
+            Synth::note(data[i + 1], static_cast<Synth::Waveform>(data[i + 2]), data[i + 3], startFreq, endFreq, duration, attack, release);
+            i += 14;
+        }
+        else if (event == SYNTH_EVENT_WAIT && i + 3 <= payload->length)
+        {
+            if (!sleepOrAbort(slot, (data[i + 1] << 8) | data[i + 2]))
+                return;
+            i += 3;
+        }
+        else if (event == SYNTH_EVENT_PCM && i + 5 <= payload->length &&
+                 i + 5 + ((data[i + 3] << 8) | data[i + 4]) <= payload->length)
+        {
+            size_t length = (data[i + 3] << 8) | data[i + 4];
+            Synth::pcm(data[i + 1], data + i + 5, length, data[i + 2]);
+            i += 5 + length;
+        }
+        else
+        {
+            Serial.printf("Invalid synth event at offset %u.\r\n", i);
+            break;
+        }
     }
-
-cleanup:
-    delete soundHex;
-    soundTaskHandle = nullptr;
-    vTaskDelete(nullptr); // Task deletes itself
+    finishSound(slot);
 }
 
 /**
@@ -307,6 +552,19 @@ void wakingUpAnimationTask(void *pvParameters)
     vTaskDelete(nullptr); // Task deletes itself
 }
 
+/**
+ * @brief Stops a task if it's running.
+ * @param taskHandle A pointer to the handle of the task being managed.
+ */
+void stopTask(TaskHandle_t *taskHandle)
+{
+    if (*taskHandle != nullptr)
+    {
+        vTaskDelete(*taskHandle);
+        *taskHandle = nullptr; // Nullify the handle after deletion
+    }
+}
+
 /**
  * @brief Stops an existing task if it's running and starts a new one.
  * @param taskCode Pointer to the function to be executed by the task.
@@ -318,17 +576,7 @@ void wakingUpAnimationTask(void *pvParameters)
  */
 void startTask(TaskFunction_t taskCode, const char *taskName, uint32_t stackSize, void *parameter, UBaseType_t priority, TaskHandle_t *taskHandle)
 {
-    // If a task is already running, delete it.
-    // The task is responsible for freeing its own memory (e.g., the String parameter).
-    // This design assumes the old task will be killed before it can clean up,
-    // leading to a memory leak of the parameter. For this project's scope,
-    // we accept this risk. A more robust solution would use a queue to pass data
-    // and signal the task to terminate and clean up gracefully.
-    if (*taskHandle != nullptr)
-    {
-        vTaskDelete(*taskHandle);
-        *taskHandle = nullptr; // Nullify the handle after deletion
-    }
+    stopTask(taskHandle);
 
     // Create the new task
     xTaskCreate(
@@ -341,16 +589,82 @@ void startTask(TaskFunction_t taskCode, const char *taskName, uint32_t stackSize
 }
 
 /**
- * @brief Handles a web request, extracts a parameter, and starts a corresponding task.
- * @param request The HTTP request object.
- * @param paramName The name of the parameter to extract from the request.
- * @param taskCode Pointer to the function to be executed by the task.
- * @param taskName A descriptive name for the task.
+ * @brief The body of a playback slot's task: plays whatever it's started with, forever.
+ * @param pvParameters A pointer to the PlaybackSlot.
+ */
+void playbackTask(void *pvParameters)
+{
+    PlaybackSlot *slot = static_cast<PlaybackSlot *>(pvParameters);
+    while (true)
+    {
+        xSemaphoreTake(slot->start, portMAX_DELAY);
+        ulTaskNotifyTake(pdTRUE, 0); // Drop wake-ups meant for an earlier clip
+        slot->play(slot);
+        xSemaphoreGive(slot->idle);
+    }
+}
+
+/**
+ * @brief Creates a playback slot's task. Called once at startup.
+ * @param slot The slot to set up.
  * @param stackSize The size of the task stack in words.
  * @param priority The priority at which the task should run.
- * @param taskHandle A pointer to the handle of the task being managed.
  */
-void handleTaskRequest(AsyncWebServerRequest *request, const char *paramName, TaskFunction_t taskCode, const char *taskName, uint32_t stackSize, UBaseType_t priority, TaskHandle_t *taskHandle)
+void setupPlaybackSlot(PlaybackSlot *slot, uint32_t stackSize, UBaseType_t priority)
+{
+    slot->start = xSemaphoreCreateBinary();
+    slot->idle = xSemaphoreCreateBinary();
+    xSemaphoreGive(slot->idle);
+    xTaskCreate(playbackTask, slot->name, stackSize, slot, priority, &slot->task);
+}
+
+/**
+ * @brief Stops a playback slot's current clip, if any, and waits until its task no longer reads the payload.
+ *        Must be called with payloadMutex held.
+ * @param slot The slot to stop.
+ */
+void stopPlayback(PlaybackSlot *slot)
+{
+    slot->abort = true;
+    xTaskNotifyGive(slot->task);
+    xSemaphoreTake(slot->idle, portMAX_DELAY);
+    xSemaphoreGive(slot->idle);
+    slot->abort = false;
+
+    // Synth voices outlive the clip that started them and PCM voices read straight from its payload,
+    // so silence them before that payload gets overwritten.
+    if (slot == &soundSlot)
+        Synth::stop();
+}
+
+/**
+ * @brief Makes a stopped playback slot play a payload. Must be called with payloadMutex held.
+ * @param slot The slot to start.
+ * @param play The function playing the payload.
+ * @param payload The payload to play.
+ */
+void startPlayback(PlaybackSlot *slot, PlayFunction play, Payload *payload)
+{
+    xSemaphoreTake(slot->idle, portMAX_DELAY);
+    slot->play = play;
+    slot->payload = payload;
+    xSemaphoreGive(slot->start);
+}
+
+/**
+ * @brief Handles a web request, decodes a hex parameter into a static payload, and plays it in a playback slot.
+ *        The parameter is decoded straight into the payload, with no copies on the application side.
+ *        ESPAsyncWebServer still allocates around it: the form-encoded body is buffered into String parameters
+ *        before the handler runs, and request->send builds temporary Strings and a response object. Those are
+ *        transient and freed once the request completes.
+ * @param request The HTTP request object.
+ * @param paramName The name of the parameter to extract from the request.
+ * @param payload The static payload the parameter is decoded into and which the slot plays.
+ * @param reassembly The UDP reassembly state of the same payload, whose clip gets abandoned.
+ * @param play The function playing the payload.
+ * @param slot The playback slot to play the payload in.
+ */
+void handleTaskRequest(AsyncWebServerRequest *request, const char *paramName, Payload *payload, UdpReassembly *reassembly, PlayFunction play, PlaybackSlot *slot)
 {
     // Stop the waking up animation if it's running
     if (wakingUpAnimationTaskHandle != nullptr)
@@ -363,31 +677,179 @@ void handleTaskRequest(AsyncWebServerRequest *request, const char *paramName, Ta
         display.display();
     }
 
-    if (request->hasParam(paramName, true))
+    const AsyncWebParameter *param = request->getParam(paramName, true);
+    if (param == nullptr)
     {
-        String *data = new String(request->getParam(paramName, true)->value());
-        startTask(taskCode, taskName, stackSize, (void *)data, priority, taskHandle);
-        request->send(200, "text/plain", "OK");
+        request->send(400, "text/plain", BAD_REQUEST_MISSING_PARAM);
+        return;
     }
-    else
+
+    // Validate first, so that a malformed request doesn't interrupt what's currently playing.
+    const String &hex = param->value();
+    Serial.printf("Decoding %u chars of hex data for %s...\r\n", hex.length(), slot->name);
+    if (!isValidHex(hex.c_str(), hex.length(), payload->capacity))
+    {
+        Serial.printf("Decoding hex for %s failed.\r\n", slot->name);
+        request->send(400, "text/plain", BAD_REQUEST_INVALID_HEX);
+        return;
+    }
+
+    xSemaphoreTake(payloadMutex, portMAX_DELAY);
+    // The slot's task reads the payload, so it has to be stopped before the payload is overwritten.
+    stopPlayback(slot);
+    payload->length = hexToBytes(hex.c_str(), hex.length(), payload->data, payload->capacity);
+    payload->startTimeMs = 0;
+    // A partially received UDP clip has just been overwritten. Mark it as done, so that its remaining
+    // fragments (and retransmits of it) are ignored rather than completing it with mixed data.
+    reassembly->started = true;
+    startPlayback(slot, play, payload);
+    xSemaphoreGive(payloadMutex);
+
+    request->send(200, "text/plain", "OK");
+}
+
+#if UDP_ENABLED
+/**
+ * @brief Adds a UDP fragment to a clip and starts the corresponding task once the clip is complete.
+ *        Must be called with payloadMutex held.
+ * @param header The header of the received packet.
+ * @param data The payload bytes of the fragment.
+ * @param reassembly The reassembly state for this payload type.
+ * @param payload The static payload the clip is assembled into and which the slot plays.
+ * @param play The function playing the payload.
+ * @param slot The playback slot to play the payload in.
+ */
+void handleUdpFragment(const UdpPacketHeader &header, const uint8_t *data, UdpReassembly *reassembly, Payload *payload, PlayFunction play, PlaybackSlot *slot)
+{
+    if (reassembly->active)
+    {
+        // Serial number arithmetic, so that the sequence may wrap around.
+        int32_t age = (int32_t)(reassembly->sequence - header.sequence);
+        if (age > 0)
+            return; // Fragment of an older clip
+        if (age == 0 && (reassembly->started || (reassembly->receivedMask & (1UL << header.fragmentIndex))))
+            return; // Retransmit of a fragment we already have
+    }
+
+    size_t offset = header.fragmentIndex * UDP_FRAGMENT_SIZE;
+    bool isLast = header.fragmentIndex + 1 == header.fragmentCount;
+    // Every fragment but the last is exactly UDP_FRAGMENT_SIZE long, so offsets stay consistent.
+    if ((isLast ? header.fragmentLength > UDP_FRAGMENT_SIZE : header.fragmentLength != UDP_FRAGMENT_SIZE) ||
+        offset + header.fragmentLength > payload->capacity)
+    {
+        Serial.printf("Dropping malformed UDP fragment %u/%u for %s.\r\n", header.fragmentIndex, header.fragmentCount, slot->name);
+        return;
+    }
+
+    if (!reassembly->active || reassembly->sequence != header.sequence)
     {
-        String errorMsg = "Bad Request: '";
-        errorMsg += paramName;
-        errorMsg += "' parameter missing.";
-        request->send(400, "text/plain", errorMsg);
+        // A new clip: the slot's task reads the payload, so it has to be stopped before the payload is overwritten.
+        stopPlayback(slot);
+        reassembly->active = true;
+        reassembly->started = false;
+        reassembly->sequence = header.sequence;
+        reassembly->receivedMask = 0;
+        payload->length = 0;
     }
+
+    memcpy(payload->data + offset, data, header.fragmentLength);
+    reassembly->receivedMask |= 1UL << header.fragmentIndex;
+    if (isLast)
+        payload->length = offset + header.fragmentLength;
+
+    uint32_t completeMask = header.fragmentCount == UDP_MAX_FRAGMENTS ? 0xFFFFFFFFUL : (1UL << header.fragmentCount) - 1;
+    if (reassembly->receivedMask != completeMask)
+        return;
+
+    Serial.printf("Received %u bytes for %s over UDP (sequence %u).\r\n", payload->length, slot->name, header.sequence);
+    reassembly->started = true;
+    payload->startTimeMs = header.startTimeMs;
+    startPlayback(slot, play, payload);
 }
 
+/**
+ * @brief Validates a UDP packet and dispatches its fragment to the matching payload type.
+ * @param packet The received packet.
+ */
+void handleUdpPacket(AsyncUDPPacket &packet)
+{
+    UdpPacketHeader header;
+    if (packet.length() < sizeof(header))
+        return;
+    memcpy(&header, packet.data(), sizeof(header));
+
+    if (header.magic[0] != 'M' || header.magic[1] != 'O' || header.version != UDP_PROTOCOL_VERSION)
+        return;
+    if (header.group != 0 && header.group != DEVICE_GROUP_ID)
+        return; // Addressed to another group of devices
+    if (header.fragmentCount == 0 || header.fragmentCount > UDP_MAX_FRAGMENTS || header.fragmentIndex >= header.fragmentCount)
+        return;
+    if (packet.length() != sizeof(header) + header.fragmentLength)
+        return;
+
+    const uint8_t *data = packet.data() + sizeof(header);
+    xSemaphoreTake(payloadMutex, portMAX_DELAY);
+    switch (header.type)
+    {
+    case UDP_PACKET_TYPE_DRAW:
+        handleUdpFragment(header, data, &animationReassembly, &animationPayload, playAnimation, &animationSlot);
+        break;
+    case UDP_PACKET_TYPE_PLAY:
+        handleUdpFragment(header, data, &soundReassembly, &soundPayload, playSound, &soundSlot);
+        break;
+    case UDP_PACKET_TYPE_SYNTH:
+        handleUdpFragment(header, data, &synthReassembly, &synthPayload, playSynth, &soundSlot);
+        break;
+    }
+    xSemaphoreGive(payloadMutex);
+}
+
+/**
+ * @brief Starts listening for UDP packets, both multicast and unicast, and synchronizes the clock for start timestamps.
+ */
+void setupUdpListener()
+{
+    configTime(0, 0, NTP_SERVER);
+
+    // Binds to any address, so unicast packets sent to UDP_PORT are received as well.
+    if (!udp.listenMulticast(UDP_MULTICAST_ADDRESS, UDP_PORT))
+    {
+        Serial.println("UDP listener failed to start.");
+        return;
+    }
+    udp.onPacket([](AsyncUDPPacket &packet)
+                 { handleUdpPacket(packet); });
+    Serial.printf("UDP listener started on port %u (group %u).\r\n", UDP_PORT, DEVICE_GROUP_ID);
+}
+#endif
+
 /**
  * @brief Configures and starts the asynchronous web server.
  */
 void setupWebServer()
 {
     server.on("/draw", HTTP_POST, [](AsyncWebServerRequest *request)
-              { handleTaskRequest(request, "frames", animationTask, "Animation Task", ANIMATION_TASK_STACK_SIZE, ANIMATION_TASK_PRIORITY, &animationTaskHandle); });
+              { handleTaskRequest(request, "frames", &animationPayload, &animationReassembly, playAnimation, &animationSlot); });
 
     server.on("/play", HTTP_POST, [](AsyncWebServerRequest *request)
-              { handleTaskRequest(request, "sound", soundTask, "Sound Task", SOUND_TASK_STACK_SIZE, SOUND_TASK_PRIORITY, &soundTaskHandle); });
+              { handleTaskRequest(request, "sound", &soundPayload, &soundReassembly, playSound, &soundSlot); });
+
+    server.on("/synth", HTTP_POST, [](AsyncWebServerRequest *request)
+              { handleTaskRequest(request, "synth", &synthPayload, &synthReassembly, playSynth, &soundSlot); });
+
+    server.on("/frame-rate", HTTP_GET, [](AsyncWebServerRequest *request)
+              {
+                  char response[96];
+                  snprintf(response, sizeof(response), "fps=%u period_ms=%u cost_us=%u budget_pct=%u",
+                           1000 / framePeriodMs, framePeriodMs, frameCostUs, FRAME_CPU_BUDGET_PERCENT);
+                  request->send(200, "text/plain", response); });
+
+    server.on("/heap", HTTP_GET, [](AsyncWebServerRequest *request)
+              {
+                  char response[96];
+                  snprintf(response, sizeof(response), "free=%u largest_free_block=%u min_free=%u",
+                           ESP.getFreeHeap(), ESP.getMaxAllocHeap(), ESP.getMinFreeHeap());
+                  request->send(200, "text/plain", response); });
 
     server.onNotFound([](AsyncWebServerRequest *request)
                       { request->send(404, "text/plain", "Not found"); });
@@ -435,9 +897,16 @@ void setup()
     pinMode(TOUCH_PIN, INPUT_PULLUP);
     attachInterrupt(digitalPinToInterrupt(TOUCH_PIN), handleTouchInterrupt, FALLING);
 
+    payloadMutex = xSemaphoreCreateMutex();
     initializeDisplay();
+    Synth::begin(BUZZER_PIN, SOUND_PWM_CHANNEL);
+    setupPlaybackSlot(&animationSlot, ANIMATION_TASK_STACK_SIZE, ANIMATION_TASK_PRIORITY);
+    setupPlaybackSlot(&soundSlot, SOUND_TASK_STACK_SIZE, SOUND_TASK_PRIORITY);
     connectToWiFi();
     setupWebServer();
+#if UDP_ENABLED
+    setupUdpListener();
+#endif
 
     Serial.println("Setup complete. Server is running.");
 
@@ -0,0 +1,171 @@
+#!/usr/bin/env python3
+"""Sends /draw, /play and /synth payloads to Mochi devices over UDP, acting as the server.
+
+Payloads are given in the same hex format as the HTTP endpoints. Every clip is
+split into fragments, tagged with a sequence number and an optional start time,
+and sent (and retransmitted) to the multicast group or a single device.
+
+With --loopback the packets are sent to a receiver running in this process,
+which applies the same validation, deduplication and reassembly rules as the
+firmware and prints what a device would play.
+"""
+
+import argparse
+import socket
+import struct
+import threading
+import time
+
+PROTOCOL_VERSION = 1
+FRAGMENT_SIZE = 1024
+MAX_FRAGMENTS = 32
+PACKET_TYPE_DRAW = 1
+PACKET_TYPE_PLAY = 2
+PACKET_TYPE_SYNTH = 3
+
+# Must match the payload buffer sizes in src/main.cpp; larger clips are dropped as malformed.
+PAYLOAD_CAPACITIES = {
+    PACKET_TYPE_DRAW: 20480,
+    PACKET_TYPE_PLAY: 512,
+    PACKET_TYPE_SYNTH: 8192,
+}
+
+# Must match UdpPacketHeader in src/main.cpp.
+HEADER = struct.Struct("<2sBBHHHHIQ")
+
+DEFAULT_MULTICAST_ADDRESS = "239.255.77.1"
+DEFAULT_PORT = 5002
+
+
+def build_packets(packet_type, group, sequence, start_time_ms, payload):
+    """Splits a payload into fragments and returns the encoded packets."""
+    if len(payload) > PAYLOAD_CAPACITIES[packet_type]:
+        raise ValueError(f"payload of {len(payload)} bytes exceeds the device's "
+                         f"{PAYLOAD_CAPACITIES[packet_type]} byte buffer for type {packet_type}")
+    fragments = [payload[i:i + FRAGMENT_SIZE] for i in range(0, len(payload), FRAGMENT_SIZE)] or [b""]
+    if len(fragments) > MAX_FRAGMENTS:
+        raise ValueError(f"payload of {len(payload)} bytes needs more than {MAX_FRAGMENTS} fragments")
+    return [
+        HEADER.pack(b"MO", PROTOCOL_VERSION, packet_type, group, index, len(fragments), len(fragment),
+                    sequence, start_time_ms) + fragment
+        for index, fragment in enumerate(fragments)
+    ]
+
+
+class LoopbackReceiver(threading.Thread):
+    """Mirrors the firmware's UDP handling and prints every clip that would start playing."""
+
+    def __init__(self, port, group):
+        super().__init__(daemon=True)
+        self.group = group
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.bind(("127.0.0.1", port))
+        self.sock.settimeout(0.2)
+        self.state = {}  # packet type -> [sequence, started, received fragments]
+        self.stopping = threading.Event()
+
+    def run(self):
+        while not self.stopping.is_set():
+            try:
+                data, _ = self.sock.recvfrom(2048)
+            except socket.timeout:
+                continue
+            self.handle(data)
+
+    def handle(self, data):
+        if len(data) < HEADER.size:
+            return
+        magic, version, packet_type, group, index, count, length, sequence, start_time_ms = HEADER.unpack_from(data)
+        if magic != b"MO" or version != PROTOCOL_VERSION:
+            return
+        if group not in (0, self.group):
+            return
+        if count == 0 or count > MAX_FRAGMENTS or index >= count or len(data) != HEADER.size + length:
+            return
+        if packet_type not in PAYLOAD_CAPACITIES:
+            return
+        length_ok = length <= FRAGMENT_SIZE if index + 1 == count else length == FRAGMENT_SIZE
+        if not length_ok or index * FRAGMENT_SIZE + length > PAYLOAD_CAPACITIES[packet_type]:
+            print(f"  type {packet_type} sequence {sequence}: dropped malformed fragment {index}/{count}")
+            return
+
+        state = self.state.get(packet_type)
+        if state is not None:
+            age = (state[0] - sequence) & 0xFFFFFFFF
+            if 0 < age < 0x80000000:
+                return  # Older clip
+            if age == 0 and (state[1] or index in state[2]):
+                print(f"  type {packet_type} sequence {sequence}: ignored retransmit of fragment {index}")
+                return
+        if state is None or state[0] != sequence:
+            state = self.state[packet_type] = [sequence, False, {}]
+
+        state[2][index] = data[HEADER.size:]
+        if len(state[2]) == count:
+            state[1] = True
+            payload = b"".join(state[2][i] for i in range(count))
+            delay_ms = start_time_ms - int(time.time() * 1000) if start_time_ms else 0
+            print(f"  type {packet_type} sequence {sequence}: start {len(payload)} bytes in {delay_ms} ms")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--frames", help="hex-encoded eye animation, as posted to /draw")
+    parser.add_argument("--sound", help="hex-encoded sound, as posted to /play")
+    parser.add_argument("--synth", help="hex-encoded synth events, as posted to /synth")
+    parser.add_argument("--target", default=DEFAULT_MULTICAST_ADDRESS,
+                        help="multicast group or device address (default: %(default)s)")
+    parser.add_argument("--port", type=int, default=DEFAULT_PORT, help="UDP port (default: %(default)s)")
+    parser.add_argument("--group", type=int, default=0, help="device group, 0 for all devices (default: %(default)s)")
+    parser.add_argument("--sequence", type=int,
+                        help="sequence number of the clip (default: derived from the current time)")
+    parser.add_argument("--start-delay-ms", type=int, default=500,
+                        help="start playback this long after sending, 0 to start on arrival (default: %(default)s)")
+    parser.add_argument("--retransmits", type=int, default=2,
+                        help="number of times every packet is sent again (default: %(default)s)")
+    parser.add_argument("--interval-ms", type=int, default=50,
+                        help="delay between retransmits (default: %(default)s)")
+    parser.add_argument("--loopback", action="store_true", help="send to an in-process receiver on 127.0.0.1")
+    args = parser.parse_args()
+
+    if args.frames is None and args.sound is None and args.synth is None:
+        parser.error("nothing to send, give --frames, --sound and/or --synth")
+
+    # Deriving the sequence from the clock keeps it increasing across server restarts.
+    sequence = args.sequence if args.sequence is not None else int(time.time() * 10) & 0xFFFFFFFF
+    start_time_ms = int(time.time() * 1000) + args.start_delay_ms if args.start_delay_ms > 0 else 0
+
+    packets = []
+    try:
+        if args.frames is not None:
+            packets += build_packets(PACKET_TYPE_DRAW, args.group, sequence, start_time_ms, bytes.fromhex(args.frames))
+        if args.sound is not None:
+            packets += build_packets(PACKET_TYPE_PLAY, args.group, sequence, start_time_ms, bytes.fromhex(args.sound))
+        if args.synth is not None:
+            packets += build_packets(PACKET_TYPE_SYNTH, args.group, sequence, start_time_ms, bytes.fromhex(args.synth))
+    except ValueError as error:
+        parser.error(str(error))
+
+    receiver = None
+    target = args.target
+    if args.loopback:
+        receiver = LoopbackReceiver(args.port, args.group if args.group != 0 else 1)
+        receiver.start()
+        target = "127.0.0.1"
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, 1)
+    for attempt in range(args.retransmits + 1):
+        print(f"Sending {len(packets)} packets to {target}:{args.port} (sequence {sequence}, attempt {attempt + 1})")
+        for packet in packets:
+            sock.sendto(packet, (target, args.port))
+        time.sleep(args.interval_ms / 1000)
+
+    if receiver is not None:
+        time.sleep(0.2)
+        receiver.stopping.set()
+        receiver.join()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+"""Soak tests a Mochi device with /draw and /play requests and checks its heap for leaks and fragmentation.
+
+Sends a mix of /draw and /play POSTs one after another. GET /heap is sampled
+before the run, every --sample-every requests, and once more after
+--settle-ms. The test fails if free heap at the end differs from the start by
+more than --heap-tolerance bytes. It also fails if the largest free block ever
+drops more than --block-tolerance bytes below its starting value. Requests
+and heap samples that fail (HTTP errors, connection resets, timeouts) are
+counted and make the test fail, but the run continues.
+"""
+
+import argparse
+import http.client
+import random
+import socket
+import struct
+import sys
+import time
+import urllib.error
+import urllib.parse
+import urllib.request
+
+
+# Errors of a single request that shouldn't abort the run. HTTPError is a URLError.
+REQUEST_ERRORS = (urllib.error.URLError, ConnectionError, socket.timeout, http.client.HTTPException)
+
+
+def get_heap(base_url, timeout):
+    """Returns the device's heap statistics as a dict of ints, or None if they couldn't be fetched."""
+    try:
+        with urllib.request.urlopen(f"{base_url}/heap", timeout=timeout) as response:
+            fields = response.read().decode().split()
+        return {key: int(value) for key, value in (field.split("=") for field in fields)}
+    except REQUEST_ERRORS as error:
+        print(f"GET /heap failed: {error}")
+        return None
+
+
+def post(base_url, path, name, value, timeout):
+    """POSTs a form-encoded parameter and returns the HTTP status code, or None if there was no response."""
+    body = urllib.parse.urlencode({name: value}).encode()
+    try:
+        with urllib.request.urlopen(f"{base_url}{path}", data=body, timeout=timeout) as response:
+            return response.status
+    except urllib.error.HTTPError as error:
+        return error.code
+    except REQUEST_ERRORS as error:
+        print(f"POST {path} failed: {error}")
+        return None
+
+
+def random_frames(rng):
+    """Returns a hex-encoded eye animation, as the server would post to /draw."""
+    frames = []
+    for _ in range(rng.randint(1, 40)):
+        frames.append(struct.pack("<5f", rng.uniform(-1, 1), rng.uniform(-1, 1), rng.random(), rng.random(),
+                                  rng.uniform(-10, 10)))
+    return b"".join(frames).hex()
+
+
+def random_sound(rng):
+    """Returns a hex-encoded sound, as the server would post to /play."""
+    notes = [struct.pack(">HH", rng.choice([0, rng.randint(200, 4000)]), rng.randint(10, 50))
+             for _ in range(rng.randint(1, 32))]
+    return b"".join(notes).hex()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("device", help="device address, e.g. 192.168.1.42 or localhost:5001")
+    parser.add_argument("--requests", type=int, default=10000, help="number of requests (default: %(default)s)")
+    parser.add_argument("--sample-every", type=int, default=100,
+                        help="sample the heap every this many requests (default: %(default)s)")
+    parser.add_argument("--settle-ms", type=int, default=3000,
+                        help="wait this long after the run before the final sample (default: %(default)s)")
+    parser.add_argument("--heap-tolerance", type=int, default=0,
+                        help="allowed difference in free heap between start and end (default: %(default)s)")
+    parser.add_argument("--block-tolerance", type=int, default=0,
+                        help="allowed drop of the largest free block below its start value (default: %(default)s)")
+    parser.add_argument("--timeout", type=float, default=5.0, help="HTTP timeout in seconds (default: %(default)s)")
+    parser.add_argument("--seed", type=int, default=0, help="random seed for payloads (default: %(default)s)")
+    args = parser.parse_args()
+
+    base_url = args.device if args.device.startswith("http") else f"http://{args.device}"
+    if ":" not in base_url.split("//", 1)[1]:
+        base_url += ":5001"
+    rng = random.Random(args.seed)
+
+    # Warm up once per endpoint so that one-time allocations don't count as leaks.
+    post(base_url, "/draw", "frames", random_frames(rng), args.timeout)
+    post(base_url, "/play", "sound", random_sound(rng), args.timeout)
+    time.sleep(args.settle_ms / 1000)
+
+    start = get_heap(base_url, args.timeout)
+    if start is None:
+        print("FAIL: could not read the heap statistics before the run")
+        sys.exit(1)
+    min_block = start["largest_free_block"]
+    print(f"start: {start}")
+
+    failures = 0
+    heap_errors = 0
+    for i in range(1, args.requests + 1):
+        if rng.random() < 0.5:
+            status = post(base_url, "/draw", "frames", random_frames(rng), args.timeout)
+        else:
+            status = post(base_url, "/play", "sound", random_sound(rng), args.timeout)
+        if status != 200:
+            failures += 1
+
+        if i % args.sample_every == 0:
+            heap = get_heap(base_url, args.timeout)
+            if heap is None:
+                heap_errors += 1
+                continue
+            min_block = min(min_block, heap["largest_free_block"])
+            print(f"{i}: {heap} (failed requests: {failures})")
+
+    time.sleep(args.settle_ms / 1000)
+    end = get_heap(base_url, args.timeout)
+    if end is None:
+        print("FAIL: could not read the heap statistics after the run")
+        sys.exit(1)
+    min_block = min(min_block, end["largest_free_block"])
+    print(f"end: {end}")
+
+    heap_change = end["free"] - start["free"]
+    block_drop = start["largest_free_block"] - min_block
+    print(f"net heap change: {heap_change} bytes, largest free block dropped by up to {block_drop} bytes, "
+          f"failed requests: {failures}, failed heap samples: {heap_errors}")
+
+    ok = True
+    if abs(heap_change) > args.heap_tolerance:
+        print(f"FAIL: net heap change exceeds {args.heap_tolerance} bytes")
+        ok = False
+    if block_drop > args.block_tolerance:
+        print(f"FAIL: largest free block dropped by more than {args.block_tolerance} bytes")
+        ok = False
+    if failures:
+        print("FAIL: some requests were not accepted")
+        ok = False
+    if heap_errors:
+        print("FAIL: some heap samples could not be read")
+        ok = False
+    if ok:
+        print("PASS")
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == "__main__":
+    main()